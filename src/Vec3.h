@@ -52,13 +52,26 @@ inline double dot(const Vec3& u, const Vec3& v) {
 }
 
 inline Vec3 abs(const Vec3& v) {
-  return Vec3(abs(v.x), abs(v.y), abs(v.z));
+  return Vec3(fabs(v.x), fabs(v.y), fabs(v.z));
 }
 
 inline double vmax(const Vec3& v) {
   return std::max(std::max(v.x, v.y), v.z);
 }
 
+inline int vargmax(const Vec3& v) {
+  if (v.x >= v.y && v.x >= v.z) return 0;
+  return v.y >= v.z ? 1 : 2;
+}
+
+inline Vec3 sign(const Vec3& v) {
+  return Vec3(sign(v.x), sign(v.y), sign(v.z));
+}
+
+inline Vec3 mul(const Vec3& u, const Vec3& v) {
+  return Vec3(u.x * v.x, u.y * v.y, u.z * v.z);
+}
+
 inline Vec3 mod(const Vec3& v, const double m) {
   return Vec3(rmod(v.x, m), rmod(v.y, m), rmod(v.z, m));
 }
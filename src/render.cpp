@@ -7,6 +7,12 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <memory>
 
 // src files
 #include "sdf.h"
@@ -14,21 +20,39 @@
 #include "Mat3.h"
 #include "animate.h"
 #include "threading.h"
+#include "topology.h"
+#include "server.h"
 #include "utils.h"
 
 using namespace std;
 
 // SYSTEM CONSTANTS
 // ----------------
-// Note: rendering constants defined in render();
+// Note: per-frame rendering constants defined in default_params()
 
-const int  NUM_THREADS      = 4;
+const int  NUM_THREADS      = num_cores(); // unpinned pool size
 const int  SCREEN_WIDTH     = 640;
 const int  SCREEN_HEIGHT    = 480;
 const int  SAMPLE_RATE      = 1;
 const int  MARCH_ITERATIONS = 1024;
 const bool SHADING          = true;
 const int  SHADE_ITERATIONS = 512;
+const int  BAND_HEIGHT      = 16;
+
+// encode_rows
+// -----------
+// Converts rows [row_begin, row_end) of pixels to packed 8-bit RGB
+
+string encode_rows(const vector<Vec3>& pixels, int width, int row_begin, int row_end) {
+  string bytes;
+  bytes.reserve((row_end - row_begin) * width * 3);
+  for (int pixel = row_begin * width; pixel < row_end * width; pixel++) {
+    for (int channel = 0; channel < 3; channel++) {
+      bytes += (char) clamp((int) (255 * pixels[pixel][channel]), 0, 255);
+    }
+  }
+  return bytes;
+}
 
 // generate_image
 // --------------
@@ -37,11 +61,7 @@ const int  SHADE_ITERATIONS = 512;
 void generate_image(string path, vector<Vec3>& pixels, int width, int height) {
   ofstream ofs(path, ios::binary);
   ofs << "P6\n" << width << " " << height << "\n255\n";
-  for (int pixel = 0; pixel < height * width; pixel++) {
-    for (int channel = 0; channel < 3; channel++) {
-      ofs << (char) clamp((int) (255 * pixels[pixel][channel]), 0, 255);
-    }
-  }
+  ofs << encode_rows(pixels, width, 0, height);
   ofs.close();
 }
 
@@ -49,14 +69,12 @@ void generate_image(string path, vector<Vec3>& pixels, int width, int height) {
 // ----------
 // See Jamie Wong: Surface Normals and Lighting
 // Use gradient to find normal vector to SDF
+// Gradient is analytic, from a single evaluation (see sdf.cpp)
 
-Vec3 SDF_normal(const Vec3& pos, double (*SDF)(const Vec3&)) {
-  const double eps = 0.001;
-  double d = SDF(pos);
-  double normal_x = SDF(pos + Vec3(eps, 0, 0)) - d;
-  double normal_y = SDF(pos + Vec3(0, eps, 0)) - d;
-  double normal_z = SDF(pos + Vec3(0, 0, eps)) - d;
-  return Vec3(normal_x, normal_y, normal_z).normalize();
+Vec3 SDF_normal(const Vec3& pos, double (*SDF)(const Vec3&, Vec3*)) {
+  Vec3 grad;
+  SDF(pos, &grad);
+  return grad.normalize();
 }
 
 // calculate_intensity
@@ -66,7 +84,7 @@ Vec3 SDF_normal(const Vec3& pos, double (*SDF)(const Vec3&)) {
 // > double light_intensity = calculate_intensity(light_pos, collision_pos, SDF);
 // > pixels[c + r * SCREEN_WIDTH] = Vec3(1, 1, 1) * light_intensity;
 
-double calculate_intensity(const Vec3& light_pos, const Vec3& collision_pos, double (*SDF)(const Vec3&)) {
+double calculate_intensity(const Vec3& light_pos, const Vec3& collision_pos, double (*SDF)(const Vec3&, Vec3*)) {
   Vec3 light_dir = (light_pos - collision_pos).normalize();
   return max(0.4, dot(light_dir, SDF_normal(collision_pos, SDF)));
 }
@@ -75,10 +93,11 @@ double calculate_intensity(const Vec3& light_pos, const Vec3& collision_pos, dou
 // ---------
 // Given a ray, performs march operation by iteratively get closer to surface
 
-double march_ray(const Vec3& origin, const Vec3& direction, double (*SDF)(const Vec3&)) {
+double march_ray(const Vec3& origin, const Vec3& direction, double (*SDF)(const Vec3&, Vec3*),
+                 int iterations = MARCH_ITERATIONS) {
   double t = 0.001;
-  for (int i = 0; i < MARCH_ITERATIONS; i++) {
-    double d = SDF(origin + t * direction);
+  for (int i = 0; i < iterations; i++) {
+    double d = SDF(origin + t * direction, NULL);
     if (d < 0.0001) return t;
     t += d;
   }
@@ -91,15 +110,16 @@ double march_ray(const Vec3& origin, const Vec3& direction, double (*SDF)(const
 // Start at collision point, try to reach light without intersecting object
 // Source: iquilezles.org/www/articles/rmshadows/rmshadows.htm
 
-double compute_shading(const Vec3& light_pos, const Vec3& collision_pos, double (*SDF)(const Vec3&)) {
+double compute_shading(const Vec3& light_pos, const Vec3& collision_pos, double (*SDF)(const Vec3&, Vec3*),
+                       int iterations = SHADE_ITERATIONS) {
   int k = 1;
   const Vec3 direction = light_pos - collision_pos;
 
   double res = 1.0;
   double t = 0.001;
 
-  for (int i = 0; i < SHADE_ITERATIONS; i++) {
-    double d = SDF(collision_pos + t * direction);
+  for (int i = 0; i < iterations; i++) {
+    double d = SDF(collision_pos + t * direction, NULL);
     if (d < 0.0001) return 0.0;
     res = min(res, k * d / t);
     t += d;
@@ -111,19 +131,19 @@ double compute_shading(const Vec3& light_pos, const Vec3& collision_pos, double
 // phong_reflectance
 // -----------------
 // Implementation of phong reflectance, per Wikipedia
+// Takes the surface normal N so callers can reuse a cached one
 
 Vec3 phong_reflection(const Vec3& diffuse_color,
                       double attenuation,
                       const Vec3& light_pos,
                       const Vec3& collision_pos,
                       const Vec3& camera_pos,
-                      double (*SDF)(const Vec3&))
+                      const Vec3& N)
 {
   Vec3 specular_color = Vec3(1.0, 1.0, 1.0) * attenuation;
   double specular_exponent = 50;
 
   Vec3 L = (light_pos - collision_pos).normalize();
-  Vec3 N = SDF_normal(collision_pos, SDF);
   Vec3 R = (N * dot(L, N) * 2.0) - L;
   Vec3 V = (camera_pos - collision_pos).normalize();
 
@@ -163,61 +183,419 @@ const Mat3 camera_matrix(const Vec3& camera_dir) {
   return Mat3(Vec3(p_c, 0, -p_s), Vec3(0, 1, 0), Vec3(p_s, 0, p_c));
 }
 
+// Render Parameters and Cache
+// ---------------------------
+// Everything a frame depends on, and the per-sample buffers kept between
+// renders so that only the stages touched by a parameter change are redone
+
+typedef struct render_params {
+  Vec3 camera_pos;
+  Vec3 camera_dir;
+  vector<Vec3> lights;
+  Vec3 diffuse_color;
+  int march_iterations;
+  int shade_iterations;
+} render_params_t;
+
+render_params_t default_params(const Vec3 camera_pos, const Vec3 camera_dir) {
+  render_params_t params;
+  params.camera_pos       = camera_pos;
+  params.camera_dir       = camera_dir;
+  params.lights           = { Vec3(-2, 1.5, 1.5), Vec3(0, 1.5, 0) };
+  /* params.lights        = { Vec3(-2, 0, 0), Vec3(0, 0, 2) }; */
+  params.diffuse_color    = Vec3(0.7, 0.2, 0.9);
+  params.march_iterations = MARCH_ITERATIONS;
+  params.shade_iterations = SHADE_ITERATIONS;
+  return params;
+}
+
+// Stages, as bit flags, with the parameters each depends on
+enum {
+  STAGE_MARCH    = 1 << 0, // hit buffers: camera, march_iterations
+  STAGE_SHADING  = 1 << 1, // soft shadows: lights, shade_iterations
+  STAGE_LIGHTING = 1 << 2, // phong: lights, diffuse_color
+  STAGE_ALL      = STAGE_MARCH | STAGE_SHADING | STAGE_LIGHTING
+};
+
+typedef struct frame_cache {
+  frame_cache(int num_samples, int num_pixels)
+    : t(num_samples), collision_pos(num_samples), normal(num_samples),
+      shade(num_samples), color(num_samples), pixels(num_pixels) {}
+  vector<double> t;             // march distance, 0 on miss
+  vector<Vec3>   collision_pos; // ray hit position
+  vector<Vec3>   normal;        // surface normal at hit
+  vector<double> shade;         // soft shadow factor
+  vector<Vec3>   color;         // phong color before shading
+  vector<Vec3>   pixels;        // downsampled output
+} frame_cache_t;
+
+// Per-Sample Stages
+// -----------------
+// Shared by the cached path (render_rows) and the fused one-shot path (render)
+// Supersampling enabled by changing the SAMPLE_RATE constant
+
+const int    SAMPLES_WIDTH  = SCREEN_WIDTH * SAMPLE_RATE;
+const int    SAMPLES_HEIGHT = SCREEN_HEIGHT * SAMPLE_RATE;
+const double FOV            = M_PI/3;
+
+// Constructs ray for sample n and marches it
+void march_sample(const render_params_t& params, const Mat3& orient_ray, int n,
+                  double& t, Vec3& collision_pos, Vec3& normal)
+{
+  int r = n / SAMPLES_WIDTH; int c = n % SAMPLES_WIDTH;
+
+  Vec3 ray_dir = orient_ray * get_direction(r, c, SAMPLES_WIDTH, SAMPLES_HEIGHT, FOV);
+  t = march_ray(params.camera_pos, ray_dir, SDF_scene, params.march_iterations);
+  collision_pos = params.camera_pos + t * ray_dir;
+  normal = t > 0 ? SDF_normal(collision_pos, SDF_scene) : Vec3();
+}
+
+// Soft shadow factor averaged over lights
+double shade_sample(const render_params_t& params, const Vec3& collision_pos) {
+  double shade = 1.0;
+  if (SHADING) {
+    for (Vec3 light_pos : params.lights) {
+      shade += compute_shading(light_pos, collision_pos, SDF_scene, params.shade_iterations);
+    }
+    shade /= params.lights.size();
+    shade = 2 * shade - shade * shade; // 1 - (1 - s)^2
+  }
+  return shade;
+}
+
+// Phong color averaged over lights, ambient only on miss
+Vec3 light_sample(const render_params_t& params, double t, const Vec3& collision_pos, const Vec3& normal) {
+  Vec3 color = params.diffuse_color * 0.1;
+  if (t > 0) {
+    for (Vec3 light_pos : params.lights) {
+      double atten = 1.0 / (1 + 0.1 * (light_pos - collision_pos).norm());
+      color += phong_reflection(params.diffuse_color, atten, light_pos,
+                                collision_pos, params.camera_pos, normal);
+    }
+    color /= params.lights.size();
+  }
+  return color;
+}
+
+// Output pixel index that sample n contributes to
+inline int sample_pixel(int n) {
+  int r = n / SAMPLES_WIDTH; int c = n % SAMPLES_WIDTH;
+  return (c / SAMPLE_RATE) + (r / SAMPLE_RATE) * SCREEN_WIDTH;
+}
+
+// render_rows
+// -----------
+// Runs the given stages over output rows [row_begin, row_end) of the cache
+// Disjoint row ranges may be rendered concurrently into one cache
+
+void render_rows(const render_params_t& params, frame_cache_t& cache, int stages,
+                 int row_begin, int row_end)
+{
+  int first = row_begin * SAMPLE_RATE * SAMPLES_WIDTH;
+  int last = row_end * SAMPLE_RATE * SAMPLES_WIDTH;
+
+  if (stages & STAGE_MARCH) {
+    const Mat3 orient_ray = camera_matrix(params.camera_dir);
+    for (int n = first; n < last; n++)
+      march_sample(params, orient_ray, n, cache.t[n], cache.collision_pos[n], cache.normal[n]);
+  }
+
+  if (stages & STAGE_SHADING) {
+    for (int n = first; n < last; n++)
+      cache.shade[n] = shade_sample(params, cache.collision_pos[n]);
+  }
+
+  if (stages & STAGE_LIGHTING) {
+    for (int n = first; n < last; n++)
+      cache.color[n] = light_sample(params, cache.t[n], cache.collision_pos[n], cache.normal[n]);
+  }
+
+  // Composite is cheap, always redone
+  for (int p = row_begin * SCREEN_WIDTH; p < row_end * SCREEN_WIDTH; p++)
+    cache.pixels[p] = Vec3();
+  double factor = (1.0 / (SAMPLE_RATE * SAMPLE_RATE));
+  for (int n = first; n < last; n++)
+    cache.pixels[sample_pixel(n)] += factor * cache.shade[n] * cache.color[n];
+}
+
 // render
 // ------
 // One rendering, for a given object
-// Loops over sample locations, constructs ray and marches
-// Supersampling enabled by changing the SAMPLE_RATE constant
+// Stages are fused per sample, so only the output pixels are kept
 // Outputs Portable Pixel Map format and then merged to GIF
+// Buffers are allocated by the calling worker, so they are first touched on its node
 
 void render(string frame_id, const Vec3 camera_pos, const Vec3 camera_dir) {
   cout << "...rendering frame " << frame_id << endl;;
 
-  // RENDERING CONSTANTS
-  const vector<Vec3> lights        { Vec3(-2, 1.5, 1.5), Vec3(0, 1.5, 0) };
-  /* const vector<Vec3> lights        { Vec3(-2, 0, 0), Vec3(0, 0, 2) }; */
-  const Vec3         diffuse_color = Vec3(0.7, 0.2, 0.9);
-  double (*SDF)      (const Vec3&) = SDF_scene;
-  const Mat3         orient_ray    = camera_matrix(camera_dir);
-  const double       fov           = M_PI/3;
-
+  const render_params_t params = default_params(camera_pos, camera_dir);
+  const Mat3 orient_ray = camera_matrix(camera_dir);
   vector<Vec3> pixels(SCREEN_WIDTH * SCREEN_HEIGHT);
 
-  int samples_width = SCREEN_WIDTH * SAMPLE_RATE;
-  int samples_height = SCREEN_HEIGHT * SAMPLE_RATE;
-  int num_samples = samples_width * samples_height;
+  double factor = (1.0 / (SAMPLE_RATE * SAMPLE_RATE));
+  for (int n = 0; n < SAMPLES_WIDTH * SAMPLES_HEIGHT; n++) {
+    double t;
+    Vec3 collision_pos, normal;
+    march_sample(params, orient_ray, n, t, collision_pos, normal);
+    Vec3 color = light_sample(params, t, collision_pos, normal);
+    double shade = shade_sample(params, collision_pos);
+    pixels[sample_pixel(n)] += factor * shade * color;
+  }
+
+  string path = "./image" + frame_id + ".ppm";
+  generate_image(path, pixels, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
 
-  for (int n = 0; n < num_samples; n++) {
-    int r = n / samples_width; int c = n % samples_width;
+// render_frame
+// ------------
+// Runs the given stages over the whole frame, split into row bands on pool
+// on_band(row_begin, row_end) is called on this thread as each band finishes
 
-    Vec3 ray_dir = orient_ray * get_direction(r, c, samples_width, samples_height, fov);
-    double t = march_ray(camera_pos, ray_dir, SDF);
-    Vec3 collision_pos = camera_pos + t * ray_dir;
+void render_frame(ThreadPool& pool, const render_params_t& params, frame_cache_t& cache, int stages,
+                  const function<void(int, int)>& on_band)
+{
+  // Bands report back through a queue so results stream as they finish
+  mutex m_done;
+  condition_variable cv_done;
+  queue<int> done;
+  int num_bands = (SCREEN_HEIGHT + BAND_HEIGHT - 1) / BAND_HEIGHT;
+  for (int band = 0; band < num_bands; band++) {
+    pool.schedule([&, band] {
+      int row_begin = band * BAND_HEIGHT;
+      render_rows(params, cache, stages, row_begin, min(row_begin + BAND_HEIGHT, SCREEN_HEIGHT));
+      lock_guard<mutex> lg(m_done);
+      done.push(band);
+      cv_done.notify_one();
+    });
+  }
 
-    Vec3 color = diffuse_color * 0.1;
-    if (t > 0) {
-      for (Vec3 light_pos : lights) {
-        double atten = 1.0 / (1 + 0.1 * (light_pos - collision_pos).norm());
-        color += phong_reflection(diffuse_color, atten, light_pos, collision_pos, camera_pos, SDF);
-      }
-      color /= lights.size();
-    }
+  for (int i = 0; i < num_bands; i++) {
+    unique_lock<mutex> ul(m_done);
+    cv_done.wait(ul, [&done] { return !done.empty(); });
+    int band = done.front();
+    done.pop();
+    ul.unlock();
+
+    int row_begin = band * BAND_HEIGHT;
+    on_band(row_begin, min(row_begin + BAND_HEIGHT, SCREEN_HEIGHT));
+  }
+  pool.wait();
+}
+
+// alloc_cache
+// -----------
+// Allocates a frame cache from a pool worker, so that with pinned workers
+// its pages are first touched, and thus placed, on that worker's NUMA node
+
+frame_cache_t* alloc_cache(ThreadPool& pool) {
+  frame_cache_t* cache = NULL;
+  pool.schedule([&cache] {
+    const int num_samples = SCREEN_WIDTH * SCREEN_HEIGHT * SAMPLE_RATE * SAMPLE_RATE;
+    cache = new frame_cache_t(num_samples, SCREEN_WIDTH * SCREEN_HEIGHT);
+  });
+  pool.wait();
+  return cache;
+}
+
+// node_pools
+// ----------
+// One pool per NUMA node with workers pinned to that node's cores, or a
+// single unpinned pool of NUM_THREADS workers when pin is false
+
+vector<unique_ptr<ThreadPool>> node_pools(bool pin) {
+  vector<unique_ptr<ThreadPool>> pools;
+  if (!pin) {
+    pools.emplace_back(new ThreadPool(NUM_THREADS));
+    return pools;
+  }
+  for (const vector<int>& cpus : cpu_nodes())
+    pools.emplace_back(new ThreadPool(cpus.size(), cpus));
+  return pools;
+}
+
+// at_end
+// ------
+// True if only whitespace is left in args, so trailing junk is rejected
+
+bool at_end(istringstream& args) {
+  args >> ws;
+  return args.eof();
+}
 
-    double shade = 1.0;
-    if (SHADING) {
-      for (Vec3 light_pos : lights) {
-        shade += compute_shading(light_pos, collision_pos, SDF);
+// handle_update
+// -------------
+// Applies one parameter update line to params
+// Returns stages invalidated by the update, or -1 if the line is malformed
+// A malformed line leaves params untouched
+
+int handle_update(const string& cmd, istringstream& args, render_params_t& params) {
+  if (cmd == "camera") {
+    Vec3 pos, dir;
+    if (!(args >> pos.x >> pos.y >> pos.z >> dir.x >> dir.y >> dir.z) || !at_end(args)) return -1;
+    // camera_matrix only rotates in the XZ-plane, so dir needs an XZ component
+    if (Vec3(dir.x, 0, dir.z).norm() == 0) return -1;
+    params.camera_pos = pos;
+    params.camera_dir = dir.normalize();
+    return STAGE_ALL;
+  }
+  if (cmd == "lights") {
+    vector<double> coords;
+    double v;
+    while (args >> v) coords.push_back(v);
+    if (coords.empty() || coords.size() % 3 != 0 || !args.eof()) return -1;
+    vector<Vec3> lights;
+    for (size_t i = 0; i < coords.size(); i += 3)
+      lights.push_back(Vec3(coords[i], coords[i + 1], coords[i + 2]));
+    params.lights = lights;
+    return STAGE_SHADING | STAGE_LIGHTING;
+  }
+  if (cmd == "diffuse_color") {
+    Vec3 color;
+    if (!(args >> color.x >> color.y >> color.z) || !at_end(args)) return -1;
+    params.diffuse_color = color;
+    return STAGE_LIGHTING;
+  }
+  if (cmd == "march_iterations") {
+    int n;
+    if (!(args >> n) || n <= 0 || !at_end(args)) return -1;
+    params.march_iterations = n;
+    return STAGE_ALL;
+  }
+  if (cmd == "shade_iterations") {
+    int n;
+    if (!(args >> n) || n <= 0 || !at_end(args)) return -1;
+    params.shade_iterations = n;
+    return STAGE_SHADING;
+  }
+  return -1;
+}
+
+// serve
+// -----
+// Long-running render service on a Unix socket, one client at a time
+// Thread pool and frame cache stay hot across requests and clients
+// Line protocol, each update answered with "OK" or "ERR <reason>":
+// > camera px py pz dx dy dz
+// > lights x y z [x y z ...]
+// > diffuse_color r g b
+// > march_iterations n
+// > shade_iterations n
+// > render    -> "FRAME <width> <height> <stages>", then per finished band
+//                "BAND <row_begin> <row_end>" followed by raw RGB bytes,
+//                then "DONE"; bands stream in completion order
+// > quit      -> close connection
+// > shutdown  -> close connection and stop server
+// With pin, renders stay on the first NUMA node's cores and memory
+
+int serve(const string& socket_path, bool pin) {
+  int server_fd = open_server_socket(socket_path);
+  if (server_fd < 0) {
+    cerr << "Could not listen on " << socket_path << endl;
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN); // dropped clients surface as write errors
+  cout << "Serving on " << socket_path << endl;
+
+  vector<int> cpus = pin ? cpu_nodes()[0] : vector<int>();
+  unique_ptr<ThreadPool> band_pool(new ThreadPool(pin ? cpus.size() : NUM_THREADS, cpus));
+  unique_ptr<frame_cache_t> cache(alloc_cache(*band_pool));
+  render_params_t params = default_params(Vec3(0, 0, 4), Vec3(0, 0, -1));
+  int dirty = STAGE_ALL;
+
+  int status = 0;
+  bool running = true;
+  while (running) {
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR) continue;
+      cerr << "accept failed: " << strerror(errno) << endl;
+      status = 1;
+      break;
+    }
+    SocketStream client(client_fd);
+
+    string line;
+    while (client.read_line(line)) {
+      istringstream args(line);
+      string cmd;
+      if (!(args >> cmd)) continue;
+
+      if (cmd == "quit") break;
+      if (cmd == "shutdown") { running = false; break; }
+
+      if (cmd != "render") {
+        int stages = handle_update(cmd, args, params);
+        if (stages < 0) {
+          client.write_all("ERR bad request: " + line + "\n");
+        } else {
+          dirty |= stages;
+          client.write_all("OK\n");
+        }
+        continue;
       }
-      shade /= lights.size();
-      shade = 2 * shade - shade * shade; // 1 - (1 - s)^2
+
+      const int stages = dirty;
+      dirty = 0;
+      ostringstream header;
+      header << "FRAME " << SCREEN_WIDTH << " " << SCREEN_HEIGHT << " "
+             << ((stages & STAGE_MARCH)    ? "march,"    : "")
+             << ((stages & STAGE_SHADING)  ? "shading,"  : "")
+             << ((stages & STAGE_LIGHTING) ? "lighting," : "")
+             << "composite\n";
+      client.write_all(header.str());
+
+      render_frame(*band_pool, params, *cache, stages, [&](int row_begin, int row_end) {
+        client.write_all("BAND " + to_string(row_begin) + " " + to_string(row_end) + "\n");
+        client.write_all(encode_rows(cache->pixels, SCREEN_WIDTH, row_begin, row_end));
+      });
+      client.write_all("DONE\n");
     }
-    
-    double factor = (1.0 / (SAMPLE_RATE * SAMPLE_RATE));
-    pixels[(c / SAMPLE_RATE) + (r / SAMPLE_RATE) * SCREEN_WIDTH] += factor * shade * color;
   }
 
-  string path = "./image" + frame_id + ".ppm";
-  generate_image(path, pixels, SCREEN_WIDTH, SCREEN_HEIGHT);
+  close(server_fd);
+  unlink(socket_path.c_str());
+  return status;
+}
+
+// bench
+// -----
+// Scaling benchmark: renders one frame band-parallel with 1, 2, 4, ... N
+// workers, N = num_cores(), and reports speedup over one worker
+// With pin, workers take cores in NUMA node order, filling one node first
+
+int bench(bool pin) {
+  vector<int> cpus;
+  for (const vector<int>& node : cpu_nodes())
+    cpus.insert(cpus.end(), node.begin(), node.end());
+
+  vector<int> counts;
+  for (int n = 1; n < num_cores(); n *= 2) counts.push_back(n);
+  counts.push_back(num_cores());
+
+  render_params_t params = default_params(Vec3(0, 0, 4), Vec3(0, 0, -1));
+  double base = 0;
+  cout << "threads    seconds    speedup" << endl;
+  for (int n : counts) {
+    ThreadPool pool(n, pin ? vector<int>(cpus.begin(), cpus.begin() + min(n, (int) cpus.size())) : vector<int>());
+    unique_ptr<frame_cache_t> cache(alloc_cache(pool));
+
+    auto start = chrono::steady_clock::now();
+    render_frame(pool, params, *cache, STAGE_ALL, [](int, int) {});
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (n == 1) base = seconds;
+
+    cout << setw(7) << n << setw(11) << fixed << setprecision(3) << seconds
+         << setw(10) << setprecision(2) << base / seconds << "x" << endl;
+  }
+  return 0;
+}
+
+// usage
+// -----
+
+int usage(const char* program) {
+  cerr << "Usage: " << program << " [--pin] [--serve <socket> | --bench]" << endl;
+  return 1;
 }
 
 // main
@@ -225,10 +603,28 @@ void render(string frame_id, const Vec3 camera_pos, const Vec3 camera_dir) {
 // Generates renderings for animation
 // Uses ImageMagick to generate GIFs
 // Parallelize ray marching over frames
+// `./render --serve <socket>` runs the render service instead
+// `./render --bench` runs the scaling benchmark instead
+// `--pin` pins workers to cores, one pool per NUMA node; whole frames are
+// dealt round-robin to node pools so each frame stays on one node
+
+int main(int argc, char** argv) {
+  bool pin = false;
+  string socket_path;
+  bool run_bench = false;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--pin") pin = true;
+    else if (arg == "--bench") run_bench = true;
+    else if (arg == "--serve" && i + 1 < argc && argv[i + 1][0] != '-') socket_path = argv[++i];
+    else return usage(argv[0]);
+  }
+  if (run_bench && !socket_path.empty()) return usage(argv[0]);
+  if (run_bench) return bench(pin);
+  if (!socket_path.empty()) return serve(socket_path, pin);
 
-int main() {
   cout << "Generating scene..." << endl;;
-  ThreadPool frame_pool(NUM_THREADS);
+  vector<unique_ptr<ThreadPool>> frame_pools = node_pools(pin);
 
   Dolly camera_rig(Vec3(0, 0, 4), Vec3(0, 0, -1));
   /* camera_rig.set_translate(Vec3(0, 0, 3), 5); */
@@ -242,12 +638,12 @@ int main() {
     string frame_id = padded_id(n_frame, /* width = */ 3);
     frame_t next_frame = camera_rig.get_next_frame();
 
-    frame_pool.schedule([frame_id, next_frame] { 
+    frame_pools[n_frame % frame_pools.size()]->schedule([frame_id, next_frame] { 
       render(frame_id, next_frame.pos, next_frame.dir); 
     });
   }
 
-  frame_pool.wait();
+  for (auto& frame_pool : frame_pools) frame_pool->wait();
 
   cout << endl << "Converting scene to gif..." << endl;
   system("convert -delay 20 -loop 0 image*.ppm scene.gif && rm -rf *.ppm");
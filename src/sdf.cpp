@@ -7,98 +7,142 @@
 
 using namespace std;
 
+// Gradients
+// ---------
+// Every SDF takes an optional grad out-parameter, skipped when NULL
+// Combinators pass through the gradient of the operand they select
+
 // SDF Composition
 // ---------------
 
-inline double SDF_union(double dist_a, double dist_b) {
+inline double SDF_union(double dist_a, double dist_b,
+                        Vec3* grad = NULL, const Vec3& grad_a = Vec3(), const Vec3& grad_b = Vec3()) {
+  if (grad) *grad = dist_a <= dist_b ? grad_a : grad_b;
   return min(dist_a, dist_b);
 }
 
-inline double SDF_intersect(double dist_a, double dist_b) {
+inline double SDF_intersect(double dist_a, double dist_b,
+                            Vec3* grad = NULL, const Vec3& grad_a = Vec3(), const Vec3& grad_b = Vec3()) {
+  if (grad) *grad = dist_a >= dist_b ? grad_a : grad_b;
   return max(dist_a, dist_b);
 }
 
-inline double SDF_difference(double dist_a, double dist_b) {
+inline double SDF_difference(double dist_a, double dist_b,
+                             Vec3* grad = NULL, const Vec3& grad_a = Vec3(), const Vec3& grad_b = Vec3()) {
+  if (grad) *grad = dist_a >= -1.0 * dist_b ? grad_a : -1.0 * grad_b;
   return max(dist_a, -1.0 * dist_b);
 }
 
 // SDF Primitives Functions
 // ------------------------
 
-inline double SDF_sphere(const Vec3& p, const double sphere_radius) {
-  return p.norm() - sphere_radius;
+inline double SDF_sphere(const Vec3& p, const double sphere_radius, Vec3* grad = NULL) {
+  double l = p.norm();
+  if (grad) *grad = p / l;
+  return l - sphere_radius;
 }
 
-inline double SDF_box(const Vec3& p, const Vec3& s) {
+inline double SDF_box(const Vec3& p, const Vec3& s, Vec3* grad = NULL) {
   // s is length of cuboid in each direction
-  return vmax(abs(p) - s);
+  // Gradient is the outward axis of the face furthest out
+  Vec3 q = abs(p) - s;
+  int axis = vargmax(q);
+  if (grad) {
+    *grad = Vec3();
+    (*grad)[axis] = sign(p[axis]);
+  }
+  return q[axis];
 }
 
-inline double SDF_plane(const Vec3& p, const Vec3& c, const Vec3& n) {
+inline double SDF_plane(const Vec3& p, const Vec3& c, const Vec3& n, Vec3* grad = NULL) {
+  if (grad) *grad = n;
   return dot(p - c, n);
 }
 
 // SDF Complex Functions
 // ---------------------
 
-double SDF_hedgehog(const Vec3& p, const double sphere_radius, const double noise_amplitude) {
+double SDF_hedgehog(const Vec3& p, const double sphere_radius, const double noise_amplitude, Vec3* grad = NULL) {
   // Generates spikes using interweaving sine functions
-  Vec3 s = Vec3(p).normalize(sphere_radius);
-  double delta = sin(16 * s.x) * sin(16 * s.y) * sin(16 * s.z);
-  return p.norm() - (sphere_radius + delta * noise_amplitude);
+  double l = p.norm();
+  Vec3 n = p / l;
+  Vec3 s = n * sphere_radius;
+  Vec3 sn(sin(16 * s.x), sin(16 * s.y), sin(16 * s.z));
+  double delta = sn.x * sn.y * sn.z;
+
+  if (grad) {
+    // d(delta)/ds, then through s = r * p / |p|, whose jacobian is r/|p| (I - n n^T)
+    Vec3 cs(cos(16 * s.x), cos(16 * s.y), cos(16 * s.z));
+    Vec3 d_s = 16.0 * Vec3(cs.x * sn.y * sn.z, sn.x * cs.y * sn.z, sn.x * sn.y * cs.z);
+    Vec3 d_p = (sphere_radius / l) * (d_s - dot(n, d_s) * n);
+    *grad = n - noise_amplitude * d_p;
+  }
+  return l - (sphere_radius + delta * noise_amplitude);
 }
 
-double SDF_sphere_repeated(const Vec3& p, const double sphere_radius, const double spread) {
+double SDF_sphere_repeated(const Vec3& p, const double sphere_radius, const double spread, Vec3* grad = NULL) {
   // Repeated spheres using modulus
+  // Modulus has unit derivative away from the seams
   Vec3 repeated = Vec3(rmod(p[0], spread), p[1], rmod(p[2], spread));
-  return SDF_sphere(repeated - Vec3(spread / 2), sphere_radius);
+  return SDF_sphere(repeated - Vec3(spread / 2), sphere_radius, grad);
 }
 
-double SDF_cross(const Vec3& p) {
+double SDF_cross(const Vec3& p, Vec3* grad = NULL) {
   /* double inf = 1000000.0; */
   double inf = 3.0;
-  double box1 = SDF_box(p, Vec3(inf, 1.0, 1.0));
-  double box2 = SDF_box(p, Vec3(1.0, inf, 1.0));
-  double box3 = SDF_box(p, Vec3(1.0, 1.0, inf));
-  return SDF_union(box1, SDF_union(box2, box3));
+  Vec3 g1, g2, g3;
+  double box1 = SDF_box(p, Vec3(inf, 1.0, 1.0), grad ? &g1 : NULL);
+  double box2 = SDF_box(p, Vec3(1.0, inf, 1.0), grad ? &g2 : NULL);
+  double box3 = SDF_box(p, Vec3(1.0, 1.0, inf), grad ? &g3 : NULL);
+  double box23 = SDF_union(box2, box3, grad ? &g2 : NULL, g2, g3);
+  return SDF_union(box1, box23, grad, g1, g2);
 }
 
-double SDF_wronger(const Vec3& p, double size, int iterations) {
-  double d = SDF_box(p, Vec3(size));
+double SDF_wronger(const Vec3& p, double size, int iterations, Vec3* grad = NULL) {
+  Vec3 gd, gc;
+  double d = SDF_box(p, Vec3(size), grad ? &gd : NULL);
   double s = 1.0;
 
   for (int i = 0; i < iterations; i++) {
     Vec3 a = mod(p * s, size) - (size / 2);
     Vec3 r = Vec3(size) - 3.0 * abs(a);
     s *= 3.0;
-    double c = SDF_cross(r) / s;
-    d = max(d, c);
+    double c = SDF_cross(r, grad ? &gc : NULL) / s;
+    // dr/dp = -3 * s_prev * sign(a), and the 1/s scale cancels 3 * s_prev
+    if (grad) gc = -1.0 * mul(gc, sign(a));
+    d = SDF_intersect(d, c, grad ? &gd : NULL, gd, gc);
   }
+  if (grad) *grad = gd;
   return d;
 }
 
-double SDF_menger(const Vec3& p, int iterations) {
+double SDF_menger(const Vec3& p, int iterations, Vec3* grad = NULL) {
   // Per https://aka-san.halcy.de/distance_fields_prefinal.pdf
   // https://iquilezles.org/www/articles/menger/menger.htm
 
-  double d = SDF_box(p, Vec3(1.0));
+  Vec3 gd, gc;
+  double d = SDF_box(p, Vec3(1.0), grad ? &gd : NULL);
   double s = 1.0;
 
   for (int i = 0; i < iterations; i++) {
     Vec3 a = mod(p * s, 2.0) - 1.0;
     Vec3 r = Vec3(1.0) - 3.0 * abs(a);
     s *= 3.0;
-    double c = SDF_cross(r) / s;
-    d = max(d, c);
+    double c = SDF_cross(r, grad ? &gc : NULL) / s;
+    // dr/dp = -3 * s_prev * sign(a), and the 1/s scale cancels 3 * s_prev
+    if (grad) gc = -1.0 * mul(gc, sign(a));
+    d = SDF_intersect(d, c, grad ? &gd : NULL, gd, gc);
   }
+  if (grad) *grad = gd;
   return d;
 }
 
 // SDF used when rendering
 // -----------------------
 
-double SDF_scene(const Vec3& p) {
-  double d1 = SDF_sphere(p, 1);
-  double d2 = SDF_plane(p, Vec3(0, -1.5, 0), Vec3(0, 1, 0));
-  return SDF_union(d1, d2);
+double SDF_scene(const Vec3& p, Vec3* grad) {
+  Vec3 g1, g2;
+  double d1 = SDF_sphere(p, 1, grad ? &g1 : NULL);
+  double d2 = SDF_plane(p, Vec3(0, -1.5, 0), Vec3(0, 1, 0), grad ? &g2 : NULL);
+  return SDF_union(d1, d2, grad, g1, g2);
 }
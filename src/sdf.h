@@ -5,7 +5,9 @@
 // SDF_scene
 // ------------
 // SDF used by render.cpp to generate scene
+// If grad is non-NULL, also writes the analytic gradient there
+// The gradient of an SDF is the (unnormalized) surface normal
 
-double SDF_scene(const Vec3& p);
+double SDF_scene(const Vec3& p, Vec3* grad = NULL);
 
 #endif //__SDF_H__
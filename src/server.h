@@ -0,0 +1,80 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <string>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// open_server_socket
+// ------------------
+// Binds a listening Unix domain socket at path, replacing any stale socket
+// Refuses to replace anything that is not a socket
+// Returns file descriptor, or -1 on failure
+
+inline int open_server_socket(const std::string& path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) return -1;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  struct stat st;
+  if (lstat(path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) return -1;
+    unlink(path.c_str());
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+
+  if (bind(fd, (sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// SocketStream
+// ------------
+// Line-oriented reads and full writes over a connected socket
+// Once a write fails, further writes are dropped (client went away)
+
+class SocketStream {
+  public:
+    SocketStream(int fd) : fd(fd), ok(true) {}
+    ~SocketStream() { close(fd); }
+
+    bool read_line(std::string& line) {
+      size_t end;
+      while ((end = buffer.find('\n')) == std::string::npos) {
+        char chunk[512];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+      }
+      line = buffer.substr(0, end);
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      buffer.erase(0, end + 1);
+      return true;
+    }
+
+    bool write_all(const std::string& data) {
+      size_t sent = 0;
+      while (ok && sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) ok = false;
+        else sent += n;
+      }
+      return ok;
+    }
+
+  private:
+    int fd;
+    bool ok;
+    std::string buffer;
+};
+
+#endif //__SERVER_H__
@@ -7,6 +7,8 @@
 #include <vector>
 #include <queue>
 #include <functional>
+#include <iostream>
+#include "topology.h"
 
 class Semaphore {
   public:
@@ -32,8 +34,11 @@ class Semaphore {
 
 class ThreadPool {
   public:
-    ThreadPool(size_t num)
-      : wts(num), s_workers(num), num_active(0), s_function(0) {
+    // Optionally pins worker i to cpus[i % cpus.size()]
+    ThreadPool(size_t num, const std::vector<int>& cpus = std::vector<int>())
+      : wts(num), s_workers(num), exit(false), num_active(0), s_function(0) {
+      for (size_t wid = 0; wid < num && !cpus.empty(); wid++)
+        wts[wid].cpu = cpus[wid % cpus.size()];
       // Spawn Dispatcher and Worker threads
       dt = std::thread([this] { dispatcher(); });
       for (size_t wid = 0; wid < num; wid++)
@@ -103,6 +108,8 @@ class ThreadPool {
     };
 
     void worker(size_t id) {
+      if (wts[id].cpu >= 0 && !pin_current_thread(wts[id].cpu))
+        std::cerr << "warning: could not pin worker " << id << " to CPU " << wts[id].cpu << std::endl;
       while (!exit) {
         // Wait til worker is started, indicating function assigned
         wts[id].s.wait();
@@ -128,10 +135,11 @@ class ThreadPool {
     std::thread dt;
 
     typedef struct worker_t {
-      worker_t() : s(0), free(true) {}
+      worker_t() : s(0), free(true), cpu(-1) {}
       std::thread t;            // Thread
       Semaphore s;              // Activator
       bool free;                // Availability
+      int cpu;                  // Pinned CPU, -1 if unpinned
       std::function<void()> fn; // Function to call
     } worker_t;
 
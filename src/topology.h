@@ -0,0 +1,122 @@
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// num_cores
+// ---------
+// Number of CPUs this process may run on, honouring taskset, cpusets and
+// containers; falls back to hardware_concurrency(), then to 4
+
+inline int num_cores() {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+    return CPU_COUNT(&set);
+#endif
+  unsigned n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 4;
+}
+
+// allowed_cpus
+// ------------
+// IDs of the CPUs this process may run on
+// Falls back to 0 .. num_cores() - 1 where affinity is unsupported
+
+inline std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+#endif
+  if (cpus.empty()) {
+    for (int cpu = 0; cpu < num_cores(); cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// parse_cpulist
+// -------------
+// Parses kernel cpulist format, e.g. "0-3,8-11"
+
+inline std::vector<int> parse_cpulist(const std::string& list) {
+  std::vector<int> cpus;
+  std::istringstream in(list);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    int lo, hi;
+    char dash;
+    std::istringstream r(range);
+    if (!(r >> lo)) continue;
+    if (!(r >> dash >> hi)) hi = lo;
+    for (int cpu = lo; cpu <= hi; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// read_cpulist
+// ------------
+// Reads a cpulist-format sysfs file, empty if missing
+
+inline std::vector<int> read_cpulist(const std::string& path) {
+  std::ifstream ifs(path);
+  std::string list;
+  if (!ifs || !std::getline(ifs, list)) return std::vector<int>();
+  return parse_cpulist(list);
+}
+
+// cpu_nodes
+// ---------
+// Allowed CPUs grouped by NUMA node, read from sysfs on Linux
+// Node IDs need not be contiguous, so they come from node/online
+// Elsewhere, or if sysfs is missing, a single node holding every allowed CPU
+
+inline std::vector<std::vector<int>> cpu_nodes() {
+  std::vector<int> allowed = allowed_cpus();
+  std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+  for (int node : read_cpulist("/sys/devices/system/node/online")) {
+    std::vector<int> cpus;
+    for (int cpu : read_cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))
+      if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) cpus.push_back(cpu);
+    if (!cpus.empty()) nodes.push_back(cpus);
+  }
+#endif
+  if (nodes.empty()) nodes.push_back(allowed);
+  return nodes;
+}
+
+// pin_current_thread
+// ------------------
+// Restricts calling thread to one CPU; returns false if that failed or
+// affinity is unsupported
+// Memory the thread touches first then lands on that CPU's NUMA node
+
+inline bool pin_current_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void) cpu;
+  return false;
+#endif
+}
+
+#endif //__TOPOLOGY_H__
@@ -19,6 +19,11 @@ inline std::string padded_id(int n, int width) {
   return out.str();
 }
 
+// Sign with zero treated as positive, used as derivative of abs
+inline double sign(double v) {
+  return v < 0 ? -1.0 : 1.0;
+}
+
 // Brings negative numbers into positive range
 inline double rmod(double v, double m) {
   double mod = fmod(v, m);